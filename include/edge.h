@@ -0,0 +1,126 @@
+#ifndef EDGE_H
+#define EDGE_H
+
+#include "filter_type.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * libedge: 呼び出し側が保持するメモリ上の画像に対してエッジ検出を行うAPI
+ *
+ * FILE* を経由せず、exit() もしない。作業領域はコンテキスト生成時に確保し、
+ * 処理関数の中ではメモリ確保を行わない。エラーは edge_status_t で返す。
+ * 画素データは1画素1バイトで、stride は行の先頭同士のバイト数を表す。
+ */
+
+/* ライブラリから公開する関数(それ以外の内部関数は非公開にする) */
+#if defined(__GNUC__)
+#define EDGE_API __attribute__((visibility("default")))
+#else
+#define EDGE_API
+#endif
+
+/* ピラミッドの最大段数(段数1で縦横1/2、段数2で1/4、…) */
+#define EDGE_PYRAMID_MAX_LEVEL 4
+
+/* 処理結果のステータスコード */
+typedef enum {
+  EDGE_OK = 0,
+  EDGE_ERROR_INVALID_ARGUMENT, /* NULLポインタ、不正なサイズやフィルタ */
+  EDGE_ERROR_OUT_OF_MEMORY,    /* コンテキストの作業領域を確保できない */
+  EDGE_ERROR_IMAGE_TOO_LARGE   /* 生成時の最大サイズ、または扱える上限を超える */
+} edge_status_t;
+
+/* 作業領域と選択中のフィルタを保持するコンテキスト(内部構造は非公開) */
+typedef struct edge_context edge_context_t;
+
+/*
+ * コンテキストの生成と破棄
+ * (max_width + 2) * (max_height + 2) が INT_MAX を超える場合、および
+ * stride * height が INT_MAX を超えるバッファは EDGE_ERROR_IMAGE_TOO_LARGE。
+ */
+EDGE_API
+edge_status_t edge_context_create(edge_context_t **pt_context, int max_width,
+                                  int max_height, filter_type_t filter_type);
+EDGE_API
+void edge_context_destroy(edge_context_t *context);
+
+/*
+ * 使用するエッジ検出フィルタの切り替え(Prewitt/Sobel/Laplacian/Forsen)
+ * edge_context_get_filter は context が NULL の場合 FILTER_NEGATIVE を返す。
+ */
+EDGE_API
+edge_status_t edge_context_set_filter(edge_context_t *context,
+                                      filter_type_t filter_type);
+EDGE_API
+filter_type_t edge_context_get_filter(const edge_context_t *context);
+
+/* エッジ強度画像を dst に書き込む */
+EDGE_API
+edge_status_t edge_filter(edge_context_t *context, const unsigned char *src,
+                          int src_stride, int width, int height, int max_value,
+                          unsigned char *dst, int dst_stride);
+
+/* 大津の方法で閾値を求め、二値化した画像を dst に書き込む */
+EDGE_API
+edge_status_t edge_threshold(const unsigned char *src, int src_stride,
+                             int width, int height, int max_value,
+                             unsigned char *dst, int dst_stride,
+                             int *pt_threshold);
+
+/*
+ * フィルタ処理と二値化をまとめて行う。
+ * edge_dst が NULL の場合、エッジ強度画像はコンテキストの作業領域に置かれる。
+ * pt_threshold が NULL でなければ、求めた閾値を格納する。
+ */
+EDGE_API
+edge_status_t edge_detect(edge_context_t *context, const unsigned char *src,
+                          int src_stride, int width, int height, int max_value,
+                          unsigned char *edge_dst, int edge_stride,
+                          unsigned char *binary_dst, int binary_stride,
+                          int *pt_threshold);
+
+/* 段数 level の画像サイズ(各段で縦横を切り上げで1/2にする) */
+EDGE_API
+void edge_pyramid_level_size(int width, int height, int level, int *pt_width,
+                             int *pt_height);
+
+/*
+ * 2倍ずつ縮小したピラミッドの段数 level 上でフィルタ処理と二値化を行う。
+ * 出力サイズは edge_pyramid_level_size で求めたものになる。
+ * level が 0 の場合は edge_detect と同じ。
+ */
+EDGE_API
+edge_status_t edge_detect_pyramid(edge_context_t *context,
+                                  const unsigned char *src, int src_stride,
+                                  int width, int height, int max_value,
+                                  int level, unsigned char *edge_dst,
+                                  int edge_stride, unsigned char *binary_dst,
+                                  int binary_stride, int *pt_threshold);
+
+/*
+ * 段数 level で粗くエッジ強度を求め、粗い段の大津の閾値の1/8(Forsenは1/16)
+ * を超える画素に掛かる tile_size 四方のタイルだけを元の解像度で処理し直す。
+ * それ以外のタイルのエッジ強度は0とみなし、閾値は画像全体から求める。
+ * 出力は元の解像度。edge_dst の扱いは edge_detect と同じ。
+ */
+EDGE_API
+edge_status_t edge_detect_refined(edge_context_t *context,
+                                  const unsigned char *src, int src_stride,
+                                  int width, int height, int max_value,
+                                  int level, int tile_size,
+                                  unsigned char *edge_dst, int edge_stride,
+                                  unsigned char *binary_dst, int binary_stride,
+                                  int *pt_threshold);
+
+/* ステータスコードの説明文字列 */
+EDGE_API
+const char *edge_status_string(edge_status_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef FILTER_TYPE_H
+#define FILTER_TYPE_H
+
+/* フィルタの種類(image.h と公開ヘッダ edge.h で共有する) */
+typedef enum {
+  FILTER_NEGATIVE,
+  FILTER_PREWITT,
+  FILTER_SOBEL,
+  FILTER_LAPLACIAN,
+  FILTER_FORSEN,
+  FILTER_OTSU
+} filter_type_t;
+
+#endif
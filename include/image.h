@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "filter_type.h"
+
 /* マクロ定義 */
 #define min(A, B) ((A) < (B) ? (A) : (B))
 #define max(A, B) ((A) > (B) ? (A) : (B))
@@ -28,22 +30,30 @@ void apply_soebel_filter(image_t *result_image, image_t *original_image);
 void apply_laplacian_filter(image_t *result_image, image_t *original_image);
 void apply_8_laplacian_filter(image_t *result_image, image_t *original_image);
 void apply_forsen_filter(image_t *result_image, image_t *original_image);
+void pad_image_data(unsigned char *padded_data, const unsigned char *data,
+                    int width, int height, int stride);
+int compute_edge_magnitudes(int *magnitudes, const unsigned char *padded_data,
+                            int width, int height, filter_type_t filter_type);
+int compute_edge_magnitudes_region(int *magnitudes,
+                                   const unsigned char *padded_data, int width,
+                                   int x_begin, int y_begin, int x_end,
+                                   int y_end, filter_type_t filter_type);
+void downsample_image_data(unsigned char *dst, int dst_stride,
+                           const unsigned char *src, int src_stride, int width,
+                           int height);
+void scale_edge_magnitudes(unsigned char *data, int stride,
+                           const int *magnitudes, int width, int height,
+                           int max_magnitude, int max_value,
+                           filter_type_t filter_type);
 void write_pgm_raw_header(FILE *fp, image_t *pt_image);
 void write_pgm_raw_bitmap_data(FILE *fp, image_t *pt_image);
 void free_image(image_t *pt_image);
 int calculate_otsu_threshold(const image_t *result_image,
                              const image_t *original_image);
+int calculate_otsu_threshold_from_histogram(const int histogram[256],
+                                            int total);
 void apply_thresholding(image_t *result_image, image_t *original_image,
                         int threshold);
 void close_files(FILE *infp, FILE *outfp);
 
-typedef enum {
-  FILTER_NEGATIVE,
-  FILTER_PREWITT,
-  FILTER_SOBEL,
-  FILTER_LAPLACIAN,
-  FILTER_FORSEN,
-  FILTER_OTSU
-} filter_type_t;
-
 #endif
\ No newline at end of file
@@ -0,0 +1,441 @@
+#include "../include/edge.h"
+#include "../include/image.h"
+#include <limits.h>
+#include <string.h>
+
+/* コンテキストの定義 */
+struct edge_context {
+  int max_width;               /* 処理できる画像の最大横幅 */
+  int max_height;              /* 処理できる画像の最大縦幅 */
+  filter_type_t filter_type;   /* 選択中のエッジ検出フィルタ */
+  unsigned char *padded_data;  /* 周囲1画素を0で埋めた入力画像 */
+  int *magnitudes;             /* 正規化前のエッジ強度 */
+  unsigned char *edge_data;    /* edge_detect 用のエッジ強度画像 */
+  unsigned char *pyramid_data; /* 段数1以降の縮小画像を順に詰めた領域 */
+};
+
+static int is_edge_filter(filter_type_t filter_type) {
+  return filter_type == FILTER_PREWITT || filter_type == FILTER_SOBEL ||
+         filter_type == FILTER_LAPLACIAN || filter_type == FILTER_FORSEN;
+}
+
+/* 画素位置は int で計算するため、最後の画素の位置が INT_MAX を超えないこと */
+static edge_status_t check_buffer(const unsigned char *data, int stride,
+                                  int width, int height) {
+  if (data == NULL || width <= 0 || height <= 0 || stride < width) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  if ((size_t)(height - 1) * stride + width > INT_MAX) {
+    return EDGE_ERROR_IMAGE_TOO_LARGE;
+  }
+  return EDGE_OK;
+}
+
+static edge_status_t check_image(const unsigned char *data, int stride,
+                                 int width, int height, int max_value) {
+  edge_status_t status = check_buffer(data, stride, width, height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  if (max_value <= 0 || max_value >= 256) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  return EDGE_OK;
+}
+
+static size_t pyramid_pixels(int width, int height) {
+  size_t pixels = 0;
+  int level, level_width, level_height;
+
+  for (level = 1; level <= EDGE_PYRAMID_MAX_LEVEL; level++) {
+    edge_pyramid_level_size(width, height, level, &level_width, &level_height);
+    pixels += (size_t)level_width * level_height;
+  }
+  return pixels;
+}
+
+edge_status_t edge_context_create(edge_context_t **pt_context, int max_width,
+                                  int max_height, filter_type_t filter_type) {
+  edge_context_t *context;
+  size_t pixels, padded_pixels;
+
+  if (pt_context == NULL) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  *pt_context = NULL;
+
+  if (max_width <= 0 || max_height <= 0 || !is_edge_filter(filter_type)) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  /* 周囲1画素を加えた画素数も int で数えられる大きさに限る */
+  if ((size_t)max_width + 2 > INT_MAX / ((size_t)max_height + 2)) {
+    return EDGE_ERROR_IMAGE_TOO_LARGE;
+  }
+
+  context = (edge_context_t *)calloc(1, sizeof(edge_context_t));
+  if (context == NULL) {
+    return EDGE_ERROR_OUT_OF_MEMORY;
+  }
+
+  context->max_width = max_width;
+  context->max_height = max_height;
+  context->filter_type = filter_type;
+
+  /* 作業領域はここでまとめて確保し、処理中には確保しない */
+  pixels = (size_t)max_width * max_height;
+  padded_pixels = ((size_t)max_width + 2) * ((size_t)max_height + 2);
+  context->padded_data = (unsigned char *)malloc(padded_pixels);
+  context->magnitudes = (int *)malloc(pixels * sizeof(int));
+  context->edge_data = (unsigned char *)malloc(pixels);
+  context->pyramid_data =
+      (unsigned char *)malloc(pyramid_pixels(max_width, max_height));
+
+  if (context->padded_data == NULL || context->magnitudes == NULL ||
+      context->edge_data == NULL || context->pyramid_data == NULL) {
+    edge_context_destroy(context);
+    return EDGE_ERROR_OUT_OF_MEMORY;
+  }
+
+  *pt_context = context;
+  return EDGE_OK;
+}
+
+void edge_context_destroy(edge_context_t *context) {
+  if (context == NULL) {
+    return;
+  }
+  free(context->padded_data);
+  free(context->magnitudes);
+  free(context->edge_data);
+  free(context->pyramid_data);
+  free(context);
+}
+
+edge_status_t edge_context_set_filter(edge_context_t *context,
+                                      filter_type_t filter_type) {
+  if (context == NULL || !is_edge_filter(filter_type)) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  context->filter_type = filter_type;
+  return EDGE_OK;
+}
+
+filter_type_t edge_context_get_filter(const edge_context_t *context) {
+  if (context == NULL) {
+    return FILTER_NEGATIVE;
+  }
+  return context->filter_type;
+}
+
+edge_status_t edge_filter(edge_context_t *context, const unsigned char *src,
+                          int src_stride, int width, int height, int max_value,
+                          unsigned char *dst, int dst_stride) {
+  edge_status_t status;
+  int max_magnitude;
+
+  if (context == NULL) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  status = check_image(src, src_stride, width, height, max_value);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  status = check_buffer(dst, dst_stride, width, height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  if (width > context->max_width || height > context->max_height) {
+    return EDGE_ERROR_IMAGE_TOO_LARGE;
+  }
+
+  pad_image_data(context->padded_data, src, width, height, src_stride);
+  max_magnitude = compute_edge_magnitudes(context->magnitudes,
+                                          context->padded_data, width, height,
+                                          context->filter_type);
+  scale_edge_magnitudes(dst, dst_stride, context->magnitudes, width, height,
+                        max_magnitude, max_value, context->filter_type);
+  return EDGE_OK;
+}
+
+edge_status_t edge_threshold(const unsigned char *src, int src_stride,
+                             int width, int height, int max_value,
+                             unsigned char *dst, int dst_stride,
+                             int *pt_threshold) {
+  int x, y;
+  int histogram[256] = {0};
+  int threshold;
+  edge_status_t status;
+
+  status = check_image(src, src_stride, width, height, max_value);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  status = check_buffer(dst, dst_stride, width, height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      histogram[src[x + y * src_stride]]++;
+    }
+  }
+
+  threshold = calculate_otsu_threshold_from_histogram(histogram, width * height);
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      dst[x + y * dst_stride] =
+          (src[x + y * src_stride] > threshold) ? max_value : 0;
+    }
+  }
+
+  if (pt_threshold != NULL) {
+    *pt_threshold = threshold;
+  }
+  return EDGE_OK;
+}
+
+edge_status_t edge_detect(edge_context_t *context, const unsigned char *src,
+                          int src_stride, int width, int height, int max_value,
+                          unsigned char *edge_dst, int edge_stride,
+                          unsigned char *binary_dst, int binary_stride,
+                          int *pt_threshold) {
+  edge_status_t status;
+
+  if (context == NULL) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  /* 出力先に書き込む前に、二値画像の出力先も確認しておく */
+  status = check_buffer(binary_dst, binary_stride, width, height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  if (edge_dst == NULL) {
+    edge_dst = context->edge_data;
+    edge_stride = width;
+  }
+
+  status = edge_filter(context, src, src_stride, width, height, max_value,
+                       edge_dst, edge_stride);
+  if (status != EDGE_OK) {
+    return status;
+  }
+
+  return edge_threshold(edge_dst, edge_stride, width, height, max_value,
+                        binary_dst, binary_stride, pt_threshold);
+}
+
+void edge_pyramid_level_size(int width, int height, int level, int *pt_width,
+                             int *pt_height) {
+  int i;
+
+  /* 1x1 に達したらそれ以上は変わらないので打ち切る */
+  for (i = 0; i < level && (width > 1 || height > 1); i++) {
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+  }
+  *pt_width = width;
+  *pt_height = height;
+}
+
+/* 段数 level までの縮小画像をコンテキストの作業領域に作る */
+static edge_status_t build_pyramid(edge_context_t *context,
+                                   const unsigned char *src, int src_stride,
+                                   int width, int height, int max_value,
+                                   int level, const unsigned char **pt_level,
+                                   int *pt_width, int *pt_height) {
+  edge_status_t status;
+  unsigned char *level_data = context->pyramid_data;
+  int i;
+
+  if (level < 0 || level > EDGE_PYRAMID_MAX_LEVEL) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  status = check_image(src, src_stride, width, height, max_value);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  if (width > context->max_width || height > context->max_height) {
+    return EDGE_ERROR_IMAGE_TOO_LARGE;
+  }
+
+  for (i = 0; i < level; i++) {
+    downsample_image_data(level_data, (width + 1) / 2, src, src_stride, width,
+                          height);
+    src = level_data;
+    width = (width + 1) / 2;
+    height = (height + 1) / 2;
+    src_stride = width;
+    level_data += (size_t)width * height;
+  }
+
+  *pt_level = src;
+  *pt_width = width;
+  *pt_height = height;
+  return EDGE_OK;
+}
+
+edge_status_t edge_detect_pyramid(edge_context_t *context,
+                                  const unsigned char *src, int src_stride,
+                                  int width, int height, int max_value,
+                                  int level, unsigned char *edge_dst,
+                                  int edge_stride, unsigned char *binary_dst,
+                                  int binary_stride, int *pt_threshold) {
+  const unsigned char *level_src;
+  int level_width, level_height;
+  edge_status_t status;
+
+  if (context == NULL) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  status = build_pyramid(context, src, src_stride, width, height, max_value,
+                         level, &level_src, &level_width, &level_height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+
+  return edge_detect(context, level_src, level == 0 ? src_stride : level_width,
+                     level_width, level_height, max_value, edge_dst,
+                     edge_stride, binary_dst, binary_stride, pt_threshold);
+}
+
+/* 詳細化するタイルの判定値を、粗い段の大津の閾値の何分の1にするか */
+/* Forsenフィルタは2x2の応答のため縮小で大きく弱まり、より低い値で判定する */
+static int refine_flag_divisor(filter_type_t filter_type) {
+  return filter_type == FILTER_FORSEN ? 16 : 8;
+}
+
+/* 粗いエッジ強度画像上で、タイルに対応する範囲(周囲1画素を含む)に */
+/* flag_level を超える画素があるか */
+static int has_coarse_edge(const unsigned char *coarse, int coarse_width,
+                           int coarse_height, int level, int flag_level,
+                           int x_begin, int y_begin, int x_end, int y_end) {
+  int x, y;
+  int cx_begin = max(0, (x_begin >> level) - 1);
+  int cy_begin = max(0, (y_begin >> level) - 1);
+  int cx_end = min(coarse_width - 1, ((x_end - 1) >> level) + 1);
+  int cy_end = min(coarse_height - 1, ((y_end - 1) >> level) + 1);
+
+  for (y = cy_begin; y <= cy_end; y++) {
+    for (x = cx_begin; x <= cx_end; x++) {
+      if (coarse[x + y * coarse_width] > flag_level) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void accumulate_histogram(int histogram[256], const unsigned char *data,
+                                 int stride, int x_begin, int y_begin,
+                                 int x_end, int y_end) {
+  int x, y;
+
+  for (y = y_begin; y < y_end; y++) {
+    for (x = x_begin; x < x_end; x++) {
+      histogram[data[x + y * stride]]++;
+    }
+  }
+}
+
+edge_status_t edge_detect_refined(edge_context_t *context,
+                                  const unsigned char *src, int src_stride,
+                                  int width, int height, int max_value,
+                                  int level, int tile_size,
+                                  unsigned char *edge_dst, int edge_stride,
+                                  unsigned char *binary_dst, int binary_stride,
+                                  int *pt_threshold) {
+  int x, y, tile_x, tile_y;
+  const unsigned char *level_src;
+  int coarse_width, coarse_height;
+  int histogram[256] = {0};
+  int flag_level, threshold;
+  int max_magnitude = 0;
+  edge_status_t status;
+
+  if (context == NULL || tile_size <= 0) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  if (level < 0 || level > EDGE_PYRAMID_MAX_LEVEL) {
+    return EDGE_ERROR_INVALID_ARGUMENT;
+  }
+  status = check_buffer(binary_dst, binary_stride, width, height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  if (edge_dst != NULL) {
+    status = check_buffer(edge_dst, edge_stride, width, height);
+    if (status != EDGE_OK) {
+      return status;
+    }
+  }
+
+  /* 粗い段のエッジ強度画像を edge_data に作り、その閾値を求める */
+  status = build_pyramid(context, src, src_stride, width, height, max_value,
+                         level, &level_src, &coarse_width, &coarse_height);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  status = edge_filter(context, level_src,
+                       level == 0 ? src_stride : coarse_width, coarse_width,
+                       coarse_height, max_value, context->edge_data,
+                       coarse_width);
+  if (status != EDGE_OK) {
+    return status;
+  }
+  accumulate_histogram(histogram, context->edge_data, coarse_width, 0, 0,
+                       coarse_width, coarse_height);
+  threshold = calculate_otsu_threshold_from_histogram(
+      histogram, coarse_width * coarse_height);
+
+  /* 縮小でぼけた弱いエッジも拾えるよう、粗い閾値より低い値で判定する */
+  flag_level = threshold / refine_flag_divisor(context->filter_type);
+
+  /* 判定に通ったタイルだけ元の解像度でエッジ強度を計算する */
+  pad_image_data(context->padded_data, src, width, height, src_stride);
+  for (tile_y = 0; tile_y < height; tile_y += tile_size) {
+    int y_end = min(height, tile_y + tile_size);
+    for (tile_x = 0; tile_x < width; tile_x += tile_size) {
+      int x_end = min(width, tile_x + tile_size);
+      if (has_coarse_edge(context->edge_data, coarse_width, coarse_height,
+                          level, flag_level, tile_x, tile_y, x_end, y_end)) {
+        int magnitude = compute_edge_magnitudes_region(
+            context->magnitudes, context->padded_data, width, tile_x, tile_y,
+            x_end, y_end, context->filter_type);
+        max_magnitude = max(max_magnitude, magnitude);
+      } else {
+        for (y = tile_y; y < y_end; y++) {
+          for (x = tile_x; x < x_end; x++) {
+            context->magnitudes[x + y * width] = 0;
+          }
+        }
+      }
+    }
+  }
+
+  if (edge_dst == NULL) {
+    edge_dst = context->edge_data;
+    edge_stride = width;
+  }
+  scale_edge_magnitudes(edge_dst, edge_stride, context->magnitudes, width,
+                        height, max_magnitude, max_value,
+                        context->filter_type);
+
+  return edge_threshold(edge_dst, edge_stride, width, height, max_value,
+                        binary_dst, binary_stride, pt_threshold);
+}
+
+const char *edge_status_string(edge_status_t status) {
+  switch (status) {
+  case EDGE_OK:
+    return "success";
+  case EDGE_ERROR_INVALID_ARGUMENT:
+    return "invalid argument";
+  case EDGE_ERROR_OUT_OF_MEMORY:
+    return "out of memory";
+  case EDGE_ERROR_IMAGE_TOO_LARGE:
+    return "image is too large";
+  }
+  return "unknown status";
+}
@@ -36,12 +36,11 @@ void filtering_image(image_t *result_image, image_t *original_image) {
   }
 }
 
-void get_neighborhood(const image_t *padded_image, int x, int y, int width,
-                      int neighborhood[3][3]) {
+void get_neighborhood(const unsigned char *padded_data, int x, int y,
+                      int width, int neighborhood[3][3]) {
   for (int i = 0; i < 3; i++) {
     for (int j = 0; j < 3; j++) {
-      neighborhood[i][j] =
-          padded_image->data[(x + j - 1) + (y + i - 1) * (width + 2)];
+      neighborhood[i][j] = padded_data[(x + j - 1) + (y + i - 1) * (width + 2)];
     }
   }
 }
@@ -63,210 +62,167 @@ int apply_filter(int neighborhood[3][3], const int filter_x[3][3],
   return (int)sqrt(derivative_x * derivative_x + derivative_y * derivative_y);
 }
 
-void apply_prewitt_filter(image_t *result_image, image_t *original_image) {
-  int x, y;
-  int width, height;
-  int filter_x[3][3] = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
-  int filter_y[3][3] = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
-  float scale_factor;
+void pad_image_data(unsigned char *padded_data, const unsigned char *data,
+                    int width, int height, int stride) {
+  int y;
 
-  width = min(original_image->width, result_image->width);
-  height = min(original_image->height, result_image->height);
-
-  image_t padded_image;
-  init_image(&padded_image, width + 2, height + 2, original_image->max_value);
-  memset(padded_image.data, 0, (width + 2) * (height + 2));
+  /* 周囲1画素の枠だけを0で埋め、内側は元画像をそのまま写す */
+  memset(padded_data, 0, width + 2);
+  memset(padded_data + (height + 1) * (width + 2), 0, width + 2);
 
   for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      padded_image.data[(x + 1) + (y + 1) * (width + 2)] =
-          original_image->data[x + y * width];
-    }
+    unsigned char *row = padded_data + (y + 1) * (width + 2);
+    row[0] = 0;
+    memcpy(row + 1, data + y * stride, width);
+    row[width + 1] = 0;
   }
+}
+
+int compute_edge_magnitudes(int *magnitudes, const unsigned char *padded_data,
+                            int width, int height, filter_type_t filter_type) {
+  return compute_edge_magnitudes_region(magnitudes, padded_data, width, 0, 0,
+                                        width, height, filter_type);
+}
 
-  // Store raw magnitudes in result_image and find maximum
+int compute_edge_magnitudes_region(int *magnitudes,
+                                   const unsigned char *padded_data, int width,
+                                   int x_begin, int y_begin, int x_end,
+                                   int y_end, filter_type_t filter_type) {
+  int x, y;
+  const int prewitt_x[3][3] = {{-1, 0, 1}, {-1, 0, 1}, {-1, 0, 1}};
+  const int prewitt_y[3][3] = {{-1, -1, -1}, {0, 0, 0}, {1, 1, 1}};
+  const int sobel_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+  const int sobel_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
+  const int laplacian[3][3] = {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}};
   int max_magnitude = 0;
-  int *temp_data = (int *)malloc(width * height * sizeof(int));
 
-  for (y = 1; y <= height; y++) {
-    for (x = 1; x <= width; x++) {
+  /* 座標は元画像基準、[x_begin, x_end) x [y_begin, y_end) の範囲のみ処理 */
+  for (y = y_begin + 1; y <= y_end; y++) {
+    for (x = x_begin + 1; x <= x_end; x++) {
       int neighborhood[3][3];
-      get_neighborhood(&padded_image, x, y, width, neighborhood);
-      int magnitude = apply_filter(neighborhood, filter_x, filter_y);
-      temp_data[(x - 1) + (y - 1) * width] = magnitude;
+      int magnitude;
+      get_neighborhood(padded_data, x, y, width, neighborhood);
+      switch (filter_type) {
+      case FILTER_PREWITT:
+        magnitude = apply_filter(neighborhood, prewitt_x, prewitt_y);
+        break;
+      case FILTER_SOBEL:
+        magnitude = apply_filter(neighborhood, sobel_x, sobel_y);
+        break;
+      case FILTER_LAPLACIAN:
+        magnitude = apply_filter(neighborhood, laplacian, laplacian);
+        break;
+      case FILTER_FORSEN:
+        magnitude = abs(neighborhood[1][1] - neighborhood[2][2]) +
+                    abs(neighborhood[1][2] - neighborhood[2][1]);
+        break;
+      default:
+        magnitude = 0;
+        break;
+      }
+      magnitudes[(x - 1) + (y - 1) * width] = magnitude;
       if (magnitude > max_magnitude) {
         max_magnitude = magnitude;
       }
     }
   }
 
-  // Scale and convert to unsigned char in one pass
-  scale_factor =
-      max_magnitude > 0 ? (float)result_image->max_value / max_magnitude : 1.0f;
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      int scaled_magnitude = (int)(temp_data[x + y * width] * scale_factor);
-      result_image->data[x + y * width] =
-          (unsigned char)max(0, min(result_image->max_value, scaled_magnitude));
-    }
-  }
-
-  free(temp_data);
-
-  free_image(&padded_image);
+  return max_magnitude;
 }
 
-void apply_soebel_filter(image_t *result_image, image_t *original_image) {
+void downsample_image_data(unsigned char *dst, int dst_stride,
+                           const unsigned char *src, int src_stride, int width,
+                           int height) {
   int x, y;
-  int width, height;
-  const int filter_x[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
-  const int filter_y[3][3] = {{-1, -2, -1}, {0, 0, 0}, {1, 2, 1}};
-  float scale_factor;
-
-  width = min(original_image->width, result_image->width);
-  height = min(original_image->height, result_image->height);
-
-  image_t padded_image;
-  init_image(&padded_image, width + 2, height + 2, original_image->max_value);
-  memset(padded_image.data, 0, (width + 2) * (height + 2));
-
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      padded_image.data[(x + 1) + (y + 1) * (width + 2)] =
-          original_image->data[x + y * width];
+  int half_width = width / 2;
+  int dst_width = (width + 1) / 2;
+  int dst_height = (height + 1) / 2;
+
+  /* 2x2画素の平均(ボックスフィルタ)で縦横1/2に縮小する */
+  /* 奇数サイズの端は最終行・最終列を複製して扱う */
+  for (y = 0; y < dst_height; y++) {
+    const unsigned char *row0 = src + (2 * y) * src_stride;
+    const unsigned char *row1 =
+        (2 * y + 1 < height) ? row0 + src_stride : row0;
+    unsigned char *dst_row = dst + y * dst_stride;
+
+    /* 分岐のない内側ループ。Makefile の VECFLAGS により -O2 でもベクトル化される */
+    for (x = 0; x < half_width; x++) {
+      dst_row[x] = (unsigned char)((row0[2 * x] + row0[2 * x + 1] +
+                                    row1[2 * x] + row1[2 * x + 1] + 2) >>
+                                   2);
     }
-  }
-
-  int max_magnitude = 0;
-  int *temp_data = (int *)malloc(width * height * sizeof(int));
-
-  for (y = 1; y <= height; y++) {
-    for (x = 1; x <= width; x++) {
-      int neighborhood[3][3];
-      get_neighborhood(&padded_image, x, y, width, neighborhood);
-      int magnitude = apply_filter(neighborhood, filter_x, filter_y);
-      temp_data[(x - 1) + (y - 1) * width] = magnitude;
-      if (magnitude > max_magnitude) {
-        max_magnitude = magnitude;
-      }
+    if (dst_width > half_width) {
+      dst_row[half_width] =
+          (unsigned char)((row0[width - 1] + row1[width - 1] + 1) >> 1);
     }
   }
+}
 
-  scale_factor =
-      max_magnitude > 0 ? (float)result_image->max_value / max_magnitude : 1.0f;
+void scale_edge_magnitudes(unsigned char *data, int stride,
+                           const int *magnitudes, int width, int height,
+                           int max_magnitude, int max_value,
+                           filter_type_t filter_type) {
+  int x, y;
+  float scale_base;
+  float scale_factor;
+
+  /* Forsenフィルタは従来どおり256を基準に正規化する */
+  scale_base = filter_type == FILTER_FORSEN ? 256.0f : (float)max_value;
+  scale_factor = max_magnitude > 0 ? scale_base / max_magnitude : 1.0f;
 
   for (y = 0; y < height; y++) {
     for (x = 0; x < width; x++) {
-      int scaled_magnitude = (int)(temp_data[x + y * width] * scale_factor);
-      result_image->data[x + y * width] =
-          (unsigned char)max(0, min(result_image->max_value, scaled_magnitude));
+      int scaled_magnitude = (int)(magnitudes[x + y * width] * scale_factor);
+      data[x + y * stride] =
+          (unsigned char)max(0, min(max_value, scaled_magnitude));
     }
   }
-
-  free(temp_data);
-
-  free_image(&padded_image);
 }
 
-void apply_laplacian_filter(image_t *result_image, image_t *original_image) {
-  int x, y;
+static void apply_edge_kernel(image_t *result_image, image_t *original_image,
+                              filter_type_t filter_type) {
   int width, height;
-  const int filter[3][3] = {{0, 1, 0}, {1, -4, 1}, {0, 1, 0}};
-  float scale_factor;
 
   width = min(original_image->width, result_image->width);
   height = min(original_image->height, result_image->height);
 
   image_t padded_image;
   init_image(&padded_image, width + 2, height + 2, original_image->max_value);
-  memset(padded_image.data, 0, (width + 2) * (height + 2));
-
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      padded_image.data[(x + 1) + (y + 1) * (width + 2)] =
-          original_image->data[x + y * width];
-    }
-  }
+  pad_image_data(padded_image.data, original_image->data, width, height,
+                 original_image->width);
 
-  int max_magnitude = 0;
   int *temp_data = (int *)malloc(width * height * sizeof(int));
-
-  for (y = 1; y <= height; y++) {
-    for (x = 1; x <= width; x++) {
-      int neighborhood[3][3];
-      get_neighborhood(&padded_image, x, y, width, neighborhood);
-      int magnitude = apply_filter(neighborhood, filter, filter);
-      temp_data[(x - 1) + (y - 1) * width] = magnitude;
-      if (magnitude > max_magnitude) {
-        max_magnitude = magnitude;
-      }
-    }
+  if (temp_data == NULL) {
+    fputs("out of memory\n", stderr);
+    exit(1);
   }
 
-  scale_factor =
-      max_magnitude > 0 ? (float)result_image->max_value / max_magnitude : 1.0f;
-
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      int scaled_magnitude = (int)(temp_data[x + y * width] * scale_factor);
-      result_image->data[x + y * width] =
-          (unsigned char)max(0, min(result_image->max_value, scaled_magnitude));
-    }
-  }
+  int max_magnitude = compute_edge_magnitudes(temp_data, padded_image.data,
+                                              width, height, filter_type);
+  scale_edge_magnitudes(result_image->data, result_image->width, temp_data,
+                        width, height, max_magnitude, result_image->max_value,
+                        filter_type);
 
   free(temp_data);
 
   free_image(&padded_image);
 }
 
-void apply_forsen_filter(image_t *result_image, image_t *original_image) {
-  int x, y;
-  int width, height;
-
-  width = min(original_image->width, result_image->width);
-  height = min(original_image->height, result_image->height);
-
-  image_t padded_image;
-  init_image(&padded_image, width + 2, height + 2, original_image->max_value);
-  memset(padded_image.data, 0, (width + 2) * (height + 2));
-
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      padded_image.data[(x + 1) + (y + 1) * (width + 2)] =
-          original_image->data[x + y * width];
-    }
-  }
-
-  int max_magnitude = 0;
-  int *temp_data = (int *)malloc(original_image->width *
-                                 original_image->height * sizeof(int));
-
-  for (y = 1; y <= height; y++) {
-    for (x = 1; x <= width; x++) {
-      int neighborhood[3][3];
-      get_neighborhood(&padded_image, x, y, width, neighborhood);
-      int magnitude = abs(neighborhood[1][1] - neighborhood[2][2]) +
-                      abs(neighborhood[1][2] - neighborhood[2][1]);
-      temp_data[(x - 1) + (y - 1) * width] = magnitude;
-      if (magnitude > max_magnitude) {
-        max_magnitude = magnitude;
-      }
-    }
-  }
-
-  float scale_factor = max_magnitude > 0 ? 256.0f / max_magnitude : 1.0f;
+void apply_prewitt_filter(image_t *result_image, image_t *original_image) {
+  apply_edge_kernel(result_image, original_image, FILTER_PREWITT);
+}
 
-  for (y = 0; y < height; y++) {
-    for (x = 0; x < width; x++) {
-      int scaled_magnitude = (int)(temp_data[x + y * width] * scale_factor);
-      result_image->data[x + y * width] =
-          (unsigned char)max(0, min(result_image->max_value, scaled_magnitude));
-    }
-  }
+void apply_soebel_filter(image_t *result_image, image_t *original_image) {
+  apply_edge_kernel(result_image, original_image, FILTER_SOBEL);
+}
 
-  free(temp_data);
+void apply_laplacian_filter(image_t *result_image, image_t *original_image) {
+  apply_edge_kernel(result_image, original_image, FILTER_LAPLACIAN);
+}
 
-  free_image(&padded_image);
+void apply_forsen_filter(image_t *result_image, image_t *original_image) {
+  apply_edge_kernel(result_image, original_image, FILTER_FORSEN);
 }
 
 int calculate_otsu_threshold(const image_t *result_image,
@@ -275,23 +231,29 @@ int calculate_otsu_threshold(const image_t *result_image,
   int width, height;
   int histogram[256] = {0};
   int total = 0;  // Total number of pixels
-  float sum_B = 0;
-  float varMax = 0;
-  int threshold = 0;
-
-  float omega_0[256] = {0};       // Sum of p_i, i < k
-  float weighted_sum[256] = {0};  // Sum of i * p_i, i < k
 
   width = min(original_image->width, result_image->width);
   height = min(original_image->height, result_image->height);
 
   for (y = 0; y < height; y++) {
     for (x = 0; x < width; x++) {
-      histogram[original_image->data[x + y * width]]++;
+      histogram[original_image->data[x + y * original_image->width]]++;
       total++;
     }
   }
 
+  return calculate_otsu_threshold_from_histogram(histogram, total);
+}
+
+int calculate_otsu_threshold_from_histogram(const int histogram[256],
+                                            int total) {
+  float sum_B = 0;
+  float varMax = 0;
+  int threshold = 0;
+
+  float omega_0[256] = {0};       // Sum of p_i, i < k
+  float weighted_sum[256] = {0};  // Sum of i * p_i, i < k
+
   for (int i = 0; i < 256; i++) {
     float p_i = (float)histogram[i] / total;
     if (i == 0) {
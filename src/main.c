@@ -1,9 +1,11 @@
+#include "../include/edge.h"
 #include "../include/image.h"
 #include <dirent.h>
 #include <sys/stat.h>
 #include <string.h>
 
 #define PATH_MAX_LENGTH 1024
+#define REFINE_TILE_SIZE 16
 
 void create_directory(const char *path) {
   struct stat st;
@@ -20,15 +22,73 @@ const char *get_file_extension(const char *filename) {
 }
 
 void print_usage(const char *program_name) {
-  fprintf(stderr, "Usage: %s <filter_type>\n", program_name);
+  fprintf(stderr, "Usage: %s <filter_type> [pyramid_level [refine]]\n",
+          program_name);
   fprintf(stderr, "Filter types:\n");
   fprintf(stderr, "  prewitt    - Prewitt edge detection\n");
   fprintf(stderr, "  sobel      - Sobel edge detection\n");
   fprintf(stderr, "  laplacian  - Laplacian edge detection\n");
   fprintf(stderr, "  forsen     - Forsen edge detection\n");
+  fprintf(stderr, "Pyramid level (0-%d):\n", EDGE_PYRAMID_MAX_LEVEL);
+  fprintf(stderr, "  detect edges on the image downsampled by 2^level\n");
+  fprintf(stderr, "  refine     - re-run full resolution only on edge tiles\n");
   exit(1);
 }
 
+filter_type_t get_filter_type(const char *filter_type) {
+  if (strcmp(filter_type, "prewitt") == 0) {
+    return FILTER_PREWITT;
+  } else if (strcmp(filter_type, "sobel") == 0) {
+    return FILTER_SOBEL;
+  } else if (strcmp(filter_type, "laplacian") == 0) {
+    return FILTER_LAPLACIAN;
+  }
+  return FILTER_FORSEN;
+}
+
+// ピラミッドの指定段数でエッジ検出と二値化を行う
+int apply_pyramid_detection(image_t *result_image, image_t *threshold_image,
+                            image_t *original_image, const char *filter_type,
+                            int level, int refine) {
+  edge_context_t *context;
+  edge_status_t status;
+  int width = original_image->width;
+  int height = original_image->height;
+  int threshold = 0;
+
+  if (!refine) {
+    edge_pyramid_level_size(width, height, level, &width, &height);
+  }
+  init_image(result_image, width, height, original_image->max_value);
+  init_image(threshold_image, width, height, original_image->max_value);
+
+  status = edge_context_create(&context, original_image->width,
+                               original_image->height,
+                               get_filter_type(filter_type));
+  if (status == EDGE_OK) {
+    if (refine) {
+      status = edge_detect_refined(
+          context, original_image->data, original_image->width,
+          original_image->width, original_image->height,
+          original_image->max_value, level, REFINE_TILE_SIZE,
+          result_image->data, width, threshold_image->data, width, &threshold);
+    } else {
+      status = edge_detect_pyramid(
+          context, original_image->data, original_image->width,
+          original_image->width, original_image->height,
+          original_image->max_value, level, result_image->data, width,
+          threshold_image->data, width, &threshold);
+    }
+    edge_context_destroy(context);
+  }
+
+  if (status != EDGE_OK) {
+    fprintf(stderr, "Edge detection failed: %s\n", edge_status_string(status));
+    exit(1);
+  }
+  return threshold;
+}
+
 void apply_edge_filter(image_t *result_image, image_t *original_image,
                        const char *filter_type) {
   if (strcmp(filter_type, "prewitt") == 0) {
@@ -49,8 +109,10 @@ int main(int argc, char **argv) {
   char filtering_path[PATH_MAX_LENGTH];
   char thresholding_path[PATH_MAX_LENGTH];
   FILE *log_fp;
+  int pyramid_level = -1;
+  int refine = 0;
 
-  if (argc != 2) {
+  if (argc < 2 || argc > 4) {
     print_usage(argv[0]);
   }
 
@@ -64,6 +126,24 @@ int main(int argc, char **argv) {
     print_usage(argv[0]);
   }
 
+  // ピラミッド段数と詳細化指定の検証
+  if (argc >= 3) {
+    char *end;
+    pyramid_level = (int)strtol(argv[2], &end, 10);
+    if (*end != '\0' || pyramid_level < 0 ||
+        pyramid_level > EDGE_PYRAMID_MAX_LEVEL) {
+      fprintf(stderr, "Invalid pyramid level: %s\n", argv[2]);
+      print_usage(argv[0]);
+    }
+  }
+  if (argc == 4) {
+    if (strcmp(argv[3], "refine") != 0) {
+      fprintf(stderr, "Invalid option: %s\n", argv[3]);
+      print_usage(argv[0]);
+    }
+    refine = 1;
+  }
+
   create_directory("./filtering_out");
   create_directory("./thresholding_out");
 
@@ -126,11 +206,28 @@ int main(int argc, char **argv) {
     read_pgm_raw_header(infp, &original_image);
     read_pgm_paw_bitmap_data(infp, &original_image);
 
-    init_image(&result_image, original_image.width, original_image.height,
-               original_image.max_value);
+    image_t threshold_image;
+    int threshold;
+
+    if (pyramid_level >= 0) {
+      // ピラミッドの指定段数でエッジ検出と二値化をまとめて行う
+      threshold =
+          apply_pyramid_detection(&result_image, &threshold_image,
+                                  &original_image, filter_type, pyramid_level,
+                                  refine);
+    } else {
+      init_image(&result_image, original_image.width, original_image.height,
+                 original_image.max_value);
+
+      // 指定されたエッジ検出フィルタを適用
+      apply_edge_filter(&result_image, &original_image, filter_type);
 
-    // 指定されたエッジ検出フィルタを適用
-    apply_edge_filter(&result_image, &original_image, filter_type);
+      init_image(&threshold_image, result_image.width, result_image.height,
+                 result_image.max_value);
+
+      threshold = calculate_otsu_threshold(&threshold_image, &result_image);
+      apply_thresholding(&threshold_image, &result_image, threshold);
+    }
 
     outfp_filtering = fopen(filtering_path, "wb");
     if (outfp_filtering != NULL) {
@@ -139,15 +236,8 @@ int main(int argc, char **argv) {
       fclose(outfp_filtering);
     }
 
-    image_t threshold_image;
-    init_image(&threshold_image, result_image.width, result_image.height,
-               result_image.max_value);
-
-    int threshold = calculate_otsu_threshold(&threshold_image, &result_image);
     fprintf(log_fp, "Image: %s\nThreshold: %d\n\n", ent->d_name, threshold);
 
-    apply_thresholding(&threshold_image, &result_image, threshold);
-
     outfp_thresholding = fopen(thresholding_path, "wb");
     if (outfp_thresholding != NULL) {
       write_pgm_raw_header(outfp_thresholding, &threshold_image);